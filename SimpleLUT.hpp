@@ -5,16 +5,31 @@
 #include <cmath>
 #include <stdint.h>
 #include <algorithm>
+#include <mutex>
+
+#define PICK_TEMPLATE_DST(src_pixel_t, src_bits, dstBitDepth, template_function) \
+ (dstBitDepth == 8 ?  template_function <src_pixel_t,uint8_t,src_bits> : \
+  dstBitDepth == 32 ? template_function <src_pixel_t,uint32_t,src_bits> : \
+                      template_function <src_pixel_t,uint16_t,src_bits>)
 
 #define PICK_TEMPLATE(srcBitDepth, dstBitDepth, template_function) \
- (srcBitDepth == 8 ? \
-    dstBitDepth == 8 ?  template_function <uint8_t,uint8_t> : \
-    dstBitDepth == 32 ? template_function <uint8_t,uint32_t> : \
-                        template_function <uint8_t,uint16_t> \
-  : \
-    dstBitDepth == 8 ?  template_function <uint16_t,uint8_t> : \
-    dstBitDepth == 32 ? template_function <uint16_t,uint32_t> : \
-                        template_function <uint16_t,uint16_t>)
+ (srcBitDepth == 8 ?  PICK_TEMPLATE_DST(uint8_t, 8, dstBitDepth, template_function) : \
+  srcBitDepth == 10 ? PICK_TEMPLATE_DST(uint16_t, 10, dstBitDepth, template_function) : \
+  srcBitDepth == 12 ? PICK_TEMPLATE_DST(uint16_t, 12, dstBitDepth, template_function) : \
+  srcBitDepth == 14 ? PICK_TEMPLATE_DST(uint16_t, 14, dstBitDepth, template_function) : \
+                      PICK_TEMPLATE_DST(uint16_t, 16, dstBitDepth, template_function))
+
+// A LUT clip is 2^(srcBitDepth * dimensions) pixels wide, which must fit in an int,
+// so 2D LUTs only exist for sources of up to 14 bits and 3D LUTs of up to 10 bits
+#define PICK_TEMPLATE_2D(srcBitDepth, dstBitDepth, template_function) \
+ (srcBitDepth == 8 ?  PICK_TEMPLATE_DST(uint8_t, 8, dstBitDepth, template_function) : \
+  srcBitDepth == 10 ? PICK_TEMPLATE_DST(uint16_t, 10, dstBitDepth, template_function) : \
+  srcBitDepth == 12 ? PICK_TEMPLATE_DST(uint16_t, 12, dstBitDepth, template_function) : \
+                      PICK_TEMPLATE_DST(uint16_t, 14, dstBitDepth, template_function))
+
+#define PICK_TEMPLATE_3D(srcBitDepth, dstBitDepth, template_function) \
+ (srcBitDepth == 8 ?  PICK_TEMPLATE_DST(uint8_t, 8, dstBitDepth, template_function) : \
+                      PICK_TEMPLATE_DST(uint16_t, 10, dstBitDepth, template_function))
 
 #define no_planes std::vector<int>({0})
 #define planes_y std::vector<int>({PLANAR_Y})
@@ -74,11 +89,14 @@ private:
   int num_dst_planes;
   std::vector<int> dst_planes, dst_width, dst_height;
   
+  // Source clip and plane read by each LUT dimension, per destination plane
+  std::vector<std::vector<int>> src_clip_map, src_plane_map;
+  
   int num_writable_candidates;
   std::vector<int> writable_candidates;
   
   // Pointer to wrapper function
-  void(ApplyLUT::*wrapper_to_use) (std::vector<PVideoFrame>& src, PVideoFrame& dst) const;
+  void(ApplyLUT::*wrapper_to_use) (std::vector<PVideoFrame>& src, PVideoFrame& dst, int y_begin, int y_end) const;
   
   const int MAX_NUM_PLANES = 3;
   
@@ -91,6 +109,7 @@ private:
   };
   
   static int pitchBitShift(int bitDepth);
+  int planeRow(int y, int dp) const;
   
   void fillSrcAndLutInfo(IScriptEnvironment* env);
   bool conditionNotFulfilled(Condition cond) const;
@@ -98,6 +117,7 @@ private:
   int generateSubsampledPixelType(IScriptEnvironment* env);
   void setDstFormatAndWrapperFunction(IScriptEnvironment* env);
   void fillDstInfo();
+  void fillSrcPlaneMap();
   void findWritableCandidates();
   
 #ifdef ENABLE_CONSTRUCTOR_TESTING
@@ -109,10 +129,66 @@ private:
 public:
   
   ApplyLUT(PClip _child, std::vector<PClip> _src_clips, PClip _lut_clip, int _mode, bool _optMakeWritable, IScriptEnvironment* env);
+  void writeRows(std::vector<PVideoFrame>& src, PVideoFrame& dst, int y_begin, int y_end) const;
   PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env);
   int __stdcall SetCacheHints(int cachehints,int frame_range);
   static AVSValue __cdecl Create(AVSValue args, void*, IScriptEnvironment* env);
   
 };
 
+class ApplyLUTMulti : public GenericVideoFilter {
+  
+private:
+  
+  // Frames written along with the requested one, until their outputs read them
+  struct CachedFrames {
+    int n, num_pending;
+    std::vector<PVideoFrame> dst;
+    std::vector<bool> pending;
+  };
+  
+  std::vector<PClip> src_clips;
+  std::vector<PClip> lut_filters;
+  std::vector<ApplyLUT*> luts;
+  int num_src_clips, num_outputs;
+  
+  std::mutex cache_mutex;
+  std::vector<CachedFrames> cache;
+  std::vector<int> last_requested; // -1 until the output is first read
+  
+  // A multiple of RUN_RETRY_ROWS, so strips keep the run check schedule
+  const int STRIP_ROWS = 32;
+  const int MAX_CACHED_FRAMES = 8;
+  
+  std::vector<PVideoFrame> writeOutputs(int n, const std::vector<bool>& write, IScriptEnvironment* env);
+  int findCachedFrames(int n) const;
+  bool fetchCachedFrame(int c, int output, PVideoFrame& frame);
+  
+public:
+  
+  ApplyLUTMulti(std::vector<PClip> _src_clips, std::vector<PClip> _lut_clips, std::vector<int> _modes, IScriptEnvironment* env);
+  PVideoFrame getOutputFrame(int n, int output, IScriptEnvironment* env);
+  const VideoInfo& getOutputVideoInfo(int output) const;
+  void writeRows(std::vector<PVideoFrame>& src, PVideoFrame& dst, int y_begin, int y_end) const;
+  PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env);
+  int __stdcall SetCacheHints(int cachehints,int frame_range);
+  static AVSValue __cdecl Create(AVSValue args, void*, IScriptEnvironment* env);
+  
+};
+
+class ApplyLUTMultiOutput : public GenericVideoFilter {
+  
+private:
+  
+  ApplyLUTMulti* multi;
+  int output;
+  
+public:
+  
+  ApplyLUTMultiOutput(PClip _multi_clip, ApplyLUTMulti* _multi, int _output);
+  PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment* env);
+  int __stdcall SetCacheHints(int cachehints,int frame_range);
+  
+};
+
 extern "C" __declspec(dllexport) const char* __stdcall AvisynthPluginInit3(IScriptEnvironment* env, AVS_Linkage* vectors);
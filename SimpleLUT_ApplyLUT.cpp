@@ -4,6 +4,11 @@ int ApplyLUT::pitchBitShift(int bitDepth) {
   return bitDepth == 8 ? 0 : bitDepth == 32 ? 2 : 1;
 }
 
+// Maps a row of the first destination plane to the matching row of plane dp
+int ApplyLUT::planeRow(int y, int dp) const {
+  return (int) ((int64_t) y * dst_height[dp] / dst_height[0]);
+}
+
 PVideoFrame __stdcall ApplyLUT::GetFrame(int n, IScriptEnvironment* env) {
   
   std::vector<PVideoFrame> src(num_src_clips);
@@ -26,12 +31,17 @@ PVideoFrame __stdcall ApplyLUT::GetFrame(int n, IScriptEnvironment* env) {
     dst = &src[writable_clip];
   }
   
-  (this->*wrapper_to_use)(src, *dst);
+  writeRows(src, *dst, 0, vi.height);
   
   return *dst;
   
 }
 
+// Rows are those of the first destination plane
+void ApplyLUT::writeRows(std::vector<PVideoFrame>& src, PVideoFrame& dst, int y_begin, int y_end) const {
+  (this->*wrapper_to_use)(src, dst, y_begin, y_end);
+}
+
 int __stdcall ApplyLUT::SetCacheHints(int cachehints,int frame_range) {
   return cachehints == CACHE_GET_MTMODE ? MT_NICE_FILTER : 0;
 }
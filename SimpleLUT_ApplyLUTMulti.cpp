@@ -0,0 +1,190 @@
+#include "SimpleLUT.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+ApplyLUTMulti::ApplyLUTMulti(std::vector<PClip> _src_clips, std::vector<PClip> _lut_clips, std::vector<int> _modes, IScriptEnvironment* env) : GenericVideoFilter(_src_clips[0]), src_clips(_src_clips) {
+  
+  num_src_clips = (int) src_clips.size();
+  num_outputs = (int) _lut_clips.size();
+  
+  for (int k = 0; k < num_outputs; ++k) {
+    ApplyLUT* lut = 0;
+    try {
+      lut = new ApplyLUT(src_clips[0], src_clips, _lut_clips[k], _modes[k], false, env);
+    } catch (const AvisynthError& e) {
+      const char* msg = strncmp(e.msg, "ApplyLUT: ", 10) == 0 ? e.msg + 10 : e.msg;
+      env->ThrowError("ApplyLUTMulti: LUT clip %d: %s", k + 1, msg);
+    }
+    lut_filters.push_back(lut);
+    luts.push_back(lut);
+  }
+  
+  last_requested = std::vector<int>(num_outputs, -1);
+  vi = luts[0]->GetVideoInfo();
+  
+}
+
+std::vector<PVideoFrame> ApplyLUTMulti::writeOutputs(int n, const std::vector<bool>& write, IScriptEnvironment* env) {
+  
+  std::vector<PVideoFrame> src(num_src_clips);
+  for (int sc = 0; sc < num_src_clips; ++sc)
+    src[sc] = src_clips[sc]->GetFrame(n, env);
+  
+  std::vector<PVideoFrame> dst(num_outputs);
+  for (int k = 0; k < num_outputs; ++k)
+    if (write[k])
+      dst[k] = env->NewVideoFrame(luts[k]->GetVideoInfo());
+  
+  // Every LUT writes the same strip before moving on, so the source rows
+  // are read from memory once and stay in cache for the other LUTs
+  for (int y_begin = 0; y_begin < vi.height; y_begin += STRIP_ROWS) {
+    int y_end = std::min(y_begin + STRIP_ROWS, vi.height);
+    for (int k = 0; k < num_outputs; ++k)
+      if (write[k])
+        luts[k]->writeRows(src, dst[k], y_begin, y_end);
+  }
+  
+  return dst;
+  
+}
+
+// Must be called with cache_mutex held
+int ApplyLUTMulti::findCachedFrames(int n) const {
+  for (int c = 0; c < (int) cache.size(); ++c)
+    if (cache[c].n == n)
+      return c;
+  return -1;
+}
+
+// Must be called with cache_mutex held
+bool ApplyLUTMulti::fetchCachedFrame(int c, int output, PVideoFrame& frame) {
+  if (!cache[c].pending[output])
+    return false;
+  frame = cache[c].dst[output];
+  cache[c].pending[output] = false;
+  if (--cache[c].num_pending == 0)
+    cache.erase(cache.begin() + c);
+  return true;
+}
+
+PVideoFrame ApplyLUTMulti::getOutputFrame(int n, int output, IScriptEnvironment* env) {
+  
+  PVideoFrame frame;
+  std::vector<bool> write(num_outputs, false);
+  write[output] = true;
+  int num_written = 1;
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    last_requested[output] = n;
+    int c = findCachedFrames(n);
+    if (c >= 0 && fetchCachedFrame(c, output, frame))
+      return frame;
+    // Outputs read in step with this one, just behind it, get this frame
+    // written too; outputs never read, ahead or further behind don't
+    for (int k = 0; c < 0 && k < num_outputs; ++k) {
+      if (k != output && last_requested[k] >= 0 && last_requested[k] < n
+        && n - last_requested[k] < MAX_CACHED_FRAMES) {
+        write[k] = true;
+        ++num_written;
+      }
+    }
+  }
+  
+  // Written outside the lock
+  std::vector<PVideoFrame> dst = writeOutputs(n, write, env);
+  if (num_written == 1)
+    return dst[output];
+  
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  int c = findCachedFrames(n);
+  if (c >= 0) {
+    // Another thread got there first, its frames are kept
+    if (fetchCachedFrame(c, output, frame))
+      return frame;
+    return dst[output];
+  }
+  if ((int) cache.size() == MAX_CACHED_FRAMES)
+    cache.erase(cache.begin());
+  CachedFrames cached;
+  cached.n = n;
+  cached.num_pending = num_written - 1;
+  cached.dst = dst;
+  cached.pending = write;
+  cached.pending[output] = false;
+  cache.push_back(cached);
+  return dst[output];
+  
+}
+
+const VideoInfo& ApplyLUTMulti::getOutputVideoInfo(int output) const {
+  return luts[output]->GetVideoInfo();
+}
+
+PVideoFrame __stdcall ApplyLUTMulti::GetFrame(int n, IScriptEnvironment* env) {
+  return getOutputFrame(n, 0, env);
+}
+
+int __stdcall ApplyLUTMulti::SetCacheHints(int cachehints,int frame_range) {
+  return cachehints == CACHE_GET_MTMODE ? MT_NICE_FILTER : 0;
+}
+
+AVSValue __cdecl ApplyLUTMulti::Create(AVSValue args, void*, IScriptEnvironment* env) {
+  
+  if (!args[1].Defined())
+    env->ThrowError("ApplyLUTMulti: Parameter \"modes\" was not given a value.");
+  
+  std::vector<int> modes;
+  const char* p = args[1].AsString();
+  while (*p) {
+    char* end;
+    long mode = strtol(p, &end, 10);
+    if (end == p) {
+      if (*p != ' ' && *p != ',')
+        env->ThrowError("ApplyLUTMulti: \"modes\" must be a list of integers, such as \"2 2 1\".");
+      ++p;
+      continue;
+    }
+    if (mode < 1 || 6 < mode)
+      env->ThrowError("ApplyLUTMulti: Every mode must be an integer from 1 to 6.");
+    modes.push_back((int) mode);
+    p = end;
+  }
+  
+  int num_luts = (int) modes.size();
+  if (num_luts < 1)
+    env->ThrowError("ApplyLUTMulti: \"modes\" must contain at least one mode.");
+  
+  int num_src_clips = args[0].ArraySize() - num_luts;
+  if (num_src_clips < 1 || 3 < num_src_clips)
+    env->ThrowError("ApplyLUTMulti: From 1 to 3 source clips must be provided,\nfollowed by one LUT clip for each entry in \"modes\".");
+  
+  std::vector<PClip> src_clips(num_src_clips);
+  for (int i = 0; i < num_src_clips; ++i)
+    src_clips[i] = args[0][i].AsClip();
+  
+  std::vector<PClip> lut_clips(num_luts);
+  for (int k = 0; k < num_luts; ++k)
+    lut_clips[k] = args[0][num_src_clips + k].AsClip();
+  
+  ApplyLUTMulti* multi = new ApplyLUTMulti(src_clips, lut_clips, modes, env);
+  PClip multi_clip = multi;
+  
+  std::vector<AVSValue> outputs(num_luts);
+  for (int k = 0; k < num_luts; ++k)
+    outputs[k] = new ApplyLUTMultiOutput(multi_clip, multi, k);
+  
+  return AVSValue(outputs.data(), num_luts);
+}
+
+ApplyLUTMultiOutput::ApplyLUTMultiOutput(PClip _multi_clip, ApplyLUTMulti* _multi, int _output) : GenericVideoFilter(_multi_clip), multi(_multi), output(_output) {
+  vi = multi->getOutputVideoInfo(output);
+}
+
+PVideoFrame __stdcall ApplyLUTMultiOutput::GetFrame(int n, IScriptEnvironment* env) {
+  return multi->getOutputFrame(n, output, env);
+}
+
+int __stdcall ApplyLUTMultiOutput::SetCacheHints(int cachehints,int frame_range) {
+  return cachehints == CACHE_GET_MTMODE ? MT_NICE_FILTER : 0;
+}
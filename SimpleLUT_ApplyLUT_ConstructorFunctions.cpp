@@ -5,6 +5,7 @@ ApplyLUT::ApplyLUT(PClip _child, std::vector<PClip> _src_clips, PClip _lut_clip,
   fillSrcAndLutInfo(env);
   setDstFormatAndWrapperFunction(env);
   fillDstInfo();
+  fillSrcPlaneMap();
   findWritableCandidates();
   
 #ifdef ENABLE_CONSTRUCTOR_TESTING
@@ -197,7 +198,7 @@ void ApplyLUT::setDstFormatAndWrapperFunction(IScriptEnvironment* env) {
         vi.pixel_type = vi_lut.pixel_type;
       } else
         vi.pixel_type = generateSubsampledPixelType(env);
-      wrapper_to_use = PICK_TEMPLATE(srcBitDepth, dstBitDepth, &ApplyLUT::write_2plane_to_1plane_wrapper);
+      wrapper_to_use = PICK_TEMPLATE_2D(srcBitDepth, dstBitDepth, &ApplyLUT::write_2plane_to_1plane_wrapper);
       break;
     case 4:
       if (lut_dimensions != 2)
@@ -214,7 +215,7 @@ void ApplyLUT::setDstFormatAndWrapperFunction(IScriptEnvironment* env) {
         env->ThrowError("ApplyLUT: Mode 4 doesn't support an interleaved destination format.");
       takeFirstPlaneFromEachSource();
       vi.pixel_type = vi_lut.pixel_type;
-      wrapper_to_use = PICK_TEMPLATE(srcBitDepth, dstBitDepth, &ApplyLUT::write_2plane_to_3plane_wrapper);
+      wrapper_to_use = PICK_TEMPLATE_2D(srcBitDepth, dstBitDepth, &ApplyLUT::write_2plane_to_3plane_wrapper);
       break;
     case 5: 
       if (lut_dimensions != 3)
@@ -237,7 +238,7 @@ void ApplyLUT::setDstFormatAndWrapperFunction(IScriptEnvironment* env) {
         vi.pixel_type = vi_lut.pixel_type;
       else // num_src_clips == 3 && num_src_planes == 3
         vi.pixel_type = generateSubsampledPixelType(env);
-      wrapper_to_use = PICK_TEMPLATE(srcBitDepth, dstBitDepth, &ApplyLUT::write_3plane_to_1plane_wrapper);
+      wrapper_to_use = PICK_TEMPLATE_3D(srcBitDepth, dstBitDepth, &ApplyLUT::write_3plane_to_1plane_wrapper);
       break;
     case 6:
       if (lut_dimensions != 3)
@@ -260,7 +261,7 @@ void ApplyLUT::setDstFormatAndWrapperFunction(IScriptEnvironment* env) {
       } else // num_src_clips == 3
         takeFirstPlaneFromEachSource();
       vi.pixel_type = vi_lut.pixel_type;
-      wrapper_to_use = PICK_TEMPLATE(srcBitDepth, dstBitDepth, &ApplyLUT::write_3plane_to_3plane_wrapper);
+      wrapper_to_use = PICK_TEMPLATE_3D(srcBitDepth, dstBitDepth, &ApplyLUT::write_3plane_to_3plane_wrapper);
       break;
   }
 }
@@ -281,6 +282,24 @@ void ApplyLUT::fillDstInfo() {
   
 }
   
+void ApplyLUT::fillSrcPlaneMap() {
+  
+  // Modes 2, 4 and 6 write all destination planes in a single pass
+  int num_map_planes = mode % 2 == 0 ? 1 : num_dst_planes;
+  
+  src_clip_map = std::vector<std::vector<int>>(num_map_planes, std::vector<int>(lut_dimensions));
+  src_plane_map = std::vector<std::vector<int>>(num_map_planes, std::vector<int>(lut_dimensions));
+  for (int dp = 0; dp < num_map_planes; ++dp) {
+    for (int i = 0; i < lut_dimensions; ++i) {
+      int sc = std::min(mode == 1 ? dp : i, num_src_clips - 1),
+          sp = std::min(mode >= 5 && num_src_clips == 1 ? i : dp, num_src_planes - 1);
+      src_clip_map[dp][i] = sc;
+      src_plane_map[dp][i] = src_planes[sc][sp];
+    }
+  }
+  
+}
+  
 void ApplyLUT::findWritableCandidates() {
   if (optMakeWritable && srcBitDepth == dstBitDepth
     && !(mode == 5 && num_src_clips == 1 && num_src_planes == 3 && num_dst_planes == 3)) {
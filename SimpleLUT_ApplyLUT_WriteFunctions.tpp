@@ -1,21 +1,37 @@
-template <typename src_pixel_t, typename dst_pixel_t>
-void write_1plane_to_1plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst) const {
+// The 3-plane 2D/3D writers reuse the last lookup while the source tuple
+// repeats. A row where fewer than 1/RUN_MIN_HIT_DIVISOR of the pixels repeat
+// disables the check, which is probed again every RUN_RETRY_ROWS rows.
+// Rows are counted from the top of the frame, so writing a frame in strips
+// follows the same schedule as writing it in one call.
+static const int RUN_MIN_HIT_DIVISOR = 8;
+static const int RUN_RETRY_ROWS = 16;
+
+// Source values above the bit depth would index past the end of the LUT.
+// The check disappears when the container can't hold such values.
+template <typename src_pixel_t, int src_bits>
+static inline int clampSrc(int s) {
+  return src_bits == 8 * (int) sizeof(src_pixel_t) ? s : std::min(s, (1 << src_bits) - 1);
+}
+
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
+void write_1plane_to_1plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst, int y_begin, int y_end) const {
   for (int dp = 0; dp < num_dst_planes; ++dp) {
-    int sp = std::min(dp, num_src_planes - 1),
-        sc = std::min(dp, num_src_clips - 1);
-      
-    int src_pitch = src[sc]->GetPitch(src_planes[sc][sp]) >> src_pitch_bitshift;
-    const src_pixel_t* srcp = (const src_pixel_t*) src[sc]->GetReadPtr(src_planes[sc][sp]);
+    int sc = src_clip_map[dp][0], sp = src_plane_map[dp][0];
+    
+    int y0 = planeRow(y_begin, dp), y1 = planeRow(y_end, dp);
+    
+    int src_pitch = src[sc]->GetPitch(sp) >> src_pitch_bitshift;
+    const src_pixel_t* srcp = (const src_pixel_t*) src[sc]->GetReadPtr(sp) + y0 * src_pitch;
     const dst_pixel_t* lutp = (const dst_pixel_t*) lut->GetReadPtr(dst_planes[dp]);
     int dst_pitch = dst->GetPitch(dst_planes[dp]) >> dst_pitch_bitshift;
-    dst_pixel_t* dstp = (dst_pixel_t*) dst->GetWritePtr(dst_planes[dp]);
+    dst_pixel_t* dstp = (dst_pixel_t*) dst->GetWritePtr(dst_planes[dp]) + y0 * dst_pitch;
     
-    write_1plane_to_1plane <src_pixel_t, dst_pixel_t>
-    (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[dp], dst_height[dp]);
+    write_1plane_to_1plane <src_pixel_t, dst_pixel_t, src_bits>
+    (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[dp], y1 - y0);
   }
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
 static void write_1plane_to_1plane
 (int src_pitch, const src_pixel_t* srcp,
   int dst_pitch, const dst_pixel_t* lutp, dst_pixel_t* dstp,
@@ -29,18 +45,18 @@ static void write_1plane_to_1plane
     __assume_aligned(dstp, 64);
 #endif
     for (int x = 0; x < width; ++x)
-      dstp[x] = lutp[srcp[x]];
+      dstp[x] = lutp[clampSrc<src_pixel_t, src_bits>(srcp[x])];
     srcp += src_pitch;
     dstp += dst_pitch;
   }
   
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
-void write_1plane_to_3plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst) const {
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
+void write_1plane_to_3plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst, int y_begin, int y_end) const {
   
-  int src_pitch = src[0]->GetPitch(src_planes[0][0]) >> src_pitch_bitshift;
-  const src_pixel_t* srcp = (const src_pixel_t*) src[0]->GetReadPtr(src_planes[0][0]);
+  int src_pitch = src[0]->GetPitch(src_plane_map[0][0]) >> src_pitch_bitshift;
+  const src_pixel_t* srcp = (const src_pixel_t*) src[0]->GetReadPtr(src_plane_map[0][0]) + y_begin * src_pitch;
   
   const dst_pixel_t* lutp[3];
   int dst_pitch[3];
@@ -49,15 +65,15 @@ void write_1plane_to_3plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame&
   for (int dp = 0; dp < num_dst_planes; ++dp) {
     lutp[dp] = (const dst_pixel_t*) lut->GetReadPtr(dst_planes[dp]);
     dst_pitch[dp] = dst->GetPitch(dst_planes[dp]) >> dst_pitch_bitshift;
-    dstp[dp] = (dst_pixel_t*) dst->GetWritePtr(dst_planes[dp]);
+    dstp[dp] = (dst_pixel_t*) dst->GetWritePtr(dst_planes[dp]) + y_begin * dst_pitch[dp];
   }
   
-  write_1plane_to_3plane <src_pixel_t, dst_pixel_t>
-  (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[0], dst_height[0]);
+  write_1plane_to_3plane <src_pixel_t, dst_pixel_t, src_bits>
+  (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[0], y_end - y_begin);
   
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
 static void write_1plane_to_3plane
 (int src_pitch, const src_pixel_t* srcp,
   int dst_pitch[3], const dst_pixel_t* lutp[3], dst_pixel_t* dstp[3],
@@ -75,7 +91,7 @@ static void write_1plane_to_3plane
     __assume_aligned(dstp[2], 64);
 #endif
     for (int x = 0; x < width; ++x) {
-      int s = srcp[x];
+      int s = clampSrc<src_pixel_t, src_bits>(srcp[x]);
       dstp[0][x] = lutp[0][s];
       dstp[1][x] = lutp[1][s];
       dstp[2][x] = lutp[2][s];
@@ -88,22 +104,24 @@ static void write_1plane_to_3plane
   
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
-void write_1plane_to_3plane_packed_rgb_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst) const {
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
+void write_1plane_to_3plane_packed_rgb_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst, int y_begin, int y_end) const {
   
-  int src_pitch = src[0]->GetPitch(src_planes[0][0]) >> src_pitch_bitshift;
-  const src_pixel_t* srcp = (const src_pixel_t*) src[0]->GetReadPtr(src_planes[0][0]);
+  int src_pitch = src[0]->GetPitch(src_plane_map[0][0]) >> src_pitch_bitshift;
+  // Packed RGB is stored bottom-up, so the kernel walks the source block from
+  // its last row up: rows [y_begin, y_end) come from rows [H - y_end, H - y_begin)
+  const src_pixel_t* srcp = (const src_pixel_t*) src[0]->GetReadPtr(src_plane_map[0][0]) + (dst_height[0] - y_end) * src_pitch;
   
   int dst_pitch = dst->GetPitch() >> dst_pitch_bitshift;
   const dst_pixel_t* lutp = (const dst_pixel_t*) lut->GetReadPtr();
-  dst_pixel_t* dstp = (dst_pixel_t*) dst->GetWritePtr();
+  dst_pixel_t* dstp = (dst_pixel_t*) dst->GetWritePtr() + y_begin * dst_pitch;
   
-  write_1plane_to_3plane_packed_rgb <src_pixel_t, dst_pixel_t>
-  (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[0], dst_height[0]);
+  write_1plane_to_3plane_packed_rgb <src_pixel_t, dst_pixel_t, src_bits>
+  (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[0], y_end - y_begin);
   
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
 static void write_1plane_to_3plane_packed_rgb
 (int src_pitch, const src_pixel_t* srcp,
   int dst_pitch, const dst_pixel_t* lutp, dst_pixel_t* dstp,
@@ -119,7 +137,7 @@ static void write_1plane_to_3plane_packed_rgb
     __assume_aligned(dstp, 64);
 #endif
     for (int x = 0; x < width; ++x) {
-      int s = srcp[x];
+      int s = clampSrc<src_pixel_t, src_bits>(srcp[x]);
       int strideBGRdst = x*3, strideBGRlut = s*3;
       dstp[strideBGRdst    ] = lutp[strideBGRlut    ];
       dstp[strideBGRdst + 1] = lutp[strideBGRlut + 1];
@@ -130,22 +148,23 @@ static void write_1plane_to_3plane_packed_rgb
   
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
-void write_1plane_to_3plane_packed_rgba_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst) const {
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
+void write_1plane_to_3plane_packed_rgba_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst, int y_begin, int y_end) const {
   
-  int src_pitch = src[0]->GetPitch(src_planes[0][0]) >> src_pitch_bitshift;
-  const src_pixel_t* srcp = (const src_pixel_t*) src[0]->GetReadPtr(src_planes[0][0]);
+  int src_pitch = src[0]->GetPitch(src_plane_map[0][0]) >> src_pitch_bitshift;
+  // Same row mapping as the RGB24/48 wrapper
+  const src_pixel_t* srcp = (const src_pixel_t*) src[0]->GetReadPtr(src_plane_map[0][0]) + (dst_height[0] - y_end) * src_pitch;
   
   int dst_pitch = dst->GetPitch() >> dst_pitch_bitshift;
   const dst_pixel_t* lutp = (const dst_pixel_t*) lut->GetReadPtr();
-  dst_pixel_t* dstp = (dst_pixel_t*) dst->GetWritePtr();
+  dst_pixel_t* dstp = (dst_pixel_t*) dst->GetWritePtr() + y_begin * dst_pitch;
   
-  write_1plane_to_3plane_packed_rgba <src_pixel_t, dst_pixel_t>
-  (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[0], dst_height[0]);
+  write_1plane_to_3plane_packed_rgba <src_pixel_t, dst_pixel_t, src_bits>
+  (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[0], y_end - y_begin);
   
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
 static void write_1plane_to_3plane_packed_rgba
 (int src_pitch, const src_pixel_t* srcp,
   int dst_pitch, const dst_pixel_t* lutp, dst_pixel_t* dstp,
@@ -161,7 +180,7 @@ static void write_1plane_to_3plane_packed_rgba
     __assume_aligned(dstp, 64);
 #endif
     for (int x = 0; x < width; ++x) {
-      int s = srcp[x];
+      int s = clampSrc<src_pixel_t, src_bits>(srcp[x]);
       int strideBGRdst = x << 2, strideBGRlut = s << 2;
       dstp[strideBGRdst    ] = lutp[strideBGRlut    ];
       dstp[strideBGRdst + 1] = lutp[strideBGRlut + 1];
@@ -172,35 +191,36 @@ static void write_1plane_to_3plane_packed_rgba
   
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
-void write_2plane_to_1plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst) const {
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
+void write_2plane_to_1plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst, int y_begin, int y_end) const {
   for (int dp = 0; dp < num_dst_planes; ++dp) {
     
+    int y0 = planeRow(y_begin, dp), y1 = planeRow(y_end, dp);
+    
     const dst_pixel_t* lutp = (const dst_pixel_t*) lut->GetReadPtr(dst_planes[dp]);
     int dst_pitch = dst->GetPitch(dst_planes[dp]) >> dst_pitch_bitshift;
-    dst_pixel_t* dstp = (dst_pixel_t*) dst->GetWritePtr(dst_planes[dp]);
+    dst_pixel_t* dstp = (dst_pixel_t*) dst->GetWritePtr(dst_planes[dp]) + y0 * dst_pitch;
     
     int src_pitch[2];
     const src_pixel_t* srcp[2];
     
     for (int i = 0; i < 2; ++i) {
-      int sc = std::min(i, num_src_clips - 1),
-          sp = std::min(dp, num_src_planes - 1);
-      src_pitch[i] = src[sc]->GetPitch(src_planes[sc][sp]) >> src_pitch_bitshift;
-      srcp[i] = (const src_pixel_t*) src[sc]->GetReadPtr(src_planes[sc][sp]);
+      int sc = src_clip_map[dp][i], sp = src_plane_map[dp][i];
+      src_pitch[i] = src[sc]->GetPitch(sp) >> src_pitch_bitshift;
+      srcp[i] = (const src_pixel_t*) src[sc]->GetReadPtr(sp) + y0 * src_pitch[i];
     }
 
-    write_2plane_to_1plane <src_pixel_t, dst_pixel_t>
-    (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[dp], dst_height[dp], srcBitDepth);
+    write_2plane_to_1plane <src_pixel_t, dst_pixel_t, src_bits>
+    (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[dp], y1 - y0);
     
   }
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
 static void write_2plane_to_1plane
 (int src_pitch[2], const src_pixel_t* srcp[2],
   int dst_pitch, const dst_pixel_t* lutp, dst_pixel_t* dstp,
-  int width, int height, int srcBitDepth) {
+  int width, int height) {
   
   for (int y = 0; y < height; ++y) {
 #ifdef __INTEL_COMPILER
@@ -211,8 +231,9 @@ static void write_2plane_to_1plane
     __assume_aligned(dstp, 64);
 #endif
     for (int x = 0; x < width; ++x) {
-      int a = srcp[0][x], b = srcp[1][x];
-      dstp[x] = lutp[(b << srcBitDepth) + a];
+      int a = clampSrc<src_pixel_t, src_bits>(srcp[0][x]),
+          b = clampSrc<src_pixel_t, src_bits>(srcp[1][x]);
+      dstp[x] = lutp[(b << src_bits) + a];
     }
     srcp[0] += src_pitch[0];
     srcp[1] += src_pitch[1];
@@ -221,16 +242,16 @@ static void write_2plane_to_1plane
   
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
-void write_2plane_to_3plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst) const {
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
+void write_2plane_to_3plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst, int y_begin, int y_end) const {
   
   int src_pitch[2];
   const src_pixel_t* srcp[2];
   
   for (int i = 0; i < 2; ++i) {
-    int sc = std::min(i, num_src_clips - 1);
-    src_pitch[i] = src[sc]->GetPitch(src_planes[sc][0]) >> src_pitch_bitshift;
-    srcp[i] = (const src_pixel_t*)src[sc]->GetReadPtr(src_planes[sc][0]);
+    int sc = src_clip_map[0][i], sp = src_plane_map[0][i];
+    src_pitch[i] = src[sc]->GetPitch(sp) >> src_pitch_bitshift;
+    srcp[i] = (const src_pixel_t*)src[sc]->GetReadPtr(sp) + y_begin * src_pitch[i];
   }
 
   const dst_pixel_t* lutp[3];
@@ -240,20 +261,21 @@ void write_2plane_to_3plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame&
   for (int dp = 0; dp < num_dst_planes; ++dp) {
     lutp[dp] = (const dst_pixel_t*) lut->GetReadPtr(dst_planes[dp]);
     dst_pitch[dp] = dst->GetPitch(dst_planes[dp]) >> dst_pitch_bitshift;
-    dstp[dp] = (dst_pixel_t*) dst->GetWritePtr(dst_planes[dp]);
+    dstp[dp] = (dst_pixel_t*) dst->GetWritePtr(dst_planes[dp]) + y_begin * dst_pitch[dp];
   }
   
-  write_2plane_to_3plane <src_pixel_t, dst_pixel_t>
-  (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[0], dst_height[0], srcBitDepth);
+  write_2plane_to_3plane <src_pixel_t, dst_pixel_t, src_bits>
+  (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[0], y_end - y_begin, y_begin);
   
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
 static void write_2plane_to_3plane
 (int src_pitch[2], const src_pixel_t* srcp[2],
   int dst_pitch[3], const dst_pixel_t* lutp[3], dst_pixel_t* dstp[3],
-  int width, int height, int srcBitDepth) {
+  int width, int height, int y_begin) {
   
+  bool check_runs = y_begin % RUN_RETRY_ROWS == 0;
   for (int y = 0; y < height; ++y) {
 #ifdef __INTEL_COMPILER
     #pragma ivdep
@@ -266,12 +288,35 @@ static void write_2plane_to_3plane
     __assume_aligned(dstp[1], 64);
     __assume_aligned(dstp[2], 64);
 #endif
-    for (int x = 0; x < width; ++x) {
-      int a = srcp[0][x], b = srcp[1][x];
-      int ab = (b << srcBitDepth) + a;
-      dstp[0][x] = lutp[0][ab];
-      dstp[1][x] = lutp[1][ab];
-      dstp[2][x] = lutp[2][ab];
+    if (check_runs) {
+      int prev_ab = -1, hits = 0;
+      dst_pixel_t d0 = 0, d1 = 0, d2 = 0;
+      for (int x = 0; x < width; ++x) {
+        int a = clampSrc<src_pixel_t, src_bits>(srcp[0][x]),
+            b = clampSrc<src_pixel_t, src_bits>(srcp[1][x]);
+        int ab = (b << src_bits) + a;
+        if (ab != prev_ab) {
+          prev_ab = ab;
+          d0 = lutp[0][ab];
+          d1 = lutp[1][ab];
+          d2 = lutp[2][ab];
+        } else
+          ++hits;
+        dstp[0][x] = d0;
+        dstp[1][x] = d1;
+        dstp[2][x] = d2;
+      }
+      check_runs = hits >= width / RUN_MIN_HIT_DIVISOR;
+    } else {
+      for (int x = 0; x < width; ++x) {
+        int a = clampSrc<src_pixel_t, src_bits>(srcp[0][x]),
+            b = clampSrc<src_pixel_t, src_bits>(srcp[1][x]);
+        int ab = (b << src_bits) + a;
+        dstp[0][x] = lutp[0][ab];
+        dstp[1][x] = lutp[1][ab];
+        dstp[2][x] = lutp[2][ab];
+      }
+      check_runs = (y_begin + y + 1) % RUN_RETRY_ROWS == 0;
     }
     srcp[0] += src_pitch[0];
     srcp[1] += src_pitch[1];
@@ -282,31 +327,32 @@ static void write_2plane_to_3plane
   
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
-void write_3plane_to_1plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst) const {
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
+void write_3plane_to_1plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst, int y_begin, int y_end) const {
   for (int dp = 0; dp < num_dst_planes; ++dp) {
     
+    int y0 = planeRow(y_begin, dp), y1 = planeRow(y_end, dp);
+    
     int src_pitch[3];
     const src_pixel_t* srcp[3];
     
     for (int i = 0; i < 3; ++i) {
-      int sc = std::min(i, num_src_clips - 1),
-          sp = std::min(num_src_clips == 1 ? i : dp, num_src_planes - 1);
-      src_pitch[i] = src[sc]->GetPitch(src_planes[sc][sp]) >> src_pitch_bitshift;
-      srcp[i] = (const src_pixel_t*) src[sc]->GetReadPtr(src_planes[sc][sp]);
+      int sc = src_clip_map[dp][i], sp = src_plane_map[dp][i];
+      src_pitch[i] = src[sc]->GetPitch(sp) >> src_pitch_bitshift;
+      srcp[i] = (const src_pixel_t*) src[sc]->GetReadPtr(sp) + y0 * src_pitch[i];
     }
     
     const dst_pixel_t* lutp = (const dst_pixel_t*) lut->GetReadPtr(dst_planes[dp]);
     int dst_pitch = dst->GetPitch(dst_planes[dp]) >> dst_pitch_bitshift;
-    dst_pixel_t* dstp = (dst_pixel_t*)dst->GetWritePtr(dst_planes[dp]);
+    dst_pixel_t* dstp = (dst_pixel_t*)dst->GetWritePtr(dst_planes[dp]) + y0 * dst_pitch;
     
-    write_3plane_to_1plane <src_pixel_t, dst_pixel_t>
-    (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[dp], dst_height[dp]);
+    write_3plane_to_1plane <src_pixel_t, dst_pixel_t, src_bits>
+    (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[dp], y1 - y0);
     
   }
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
 static void write_3plane_to_1plane
 (int src_pitch[3], const src_pixel_t* srcp[3],
   int dst_pitch, const dst_pixel_t* lutp, dst_pixel_t* dstp,
@@ -322,8 +368,10 @@ static void write_3plane_to_1plane
     __assume_aligned(dstp, 64);
 #endif
     for (int x = 0; x < width; ++x) {
-      int a = srcp[0][x], b = srcp[1][x], c = srcp[2][x];
-      dstp[x] = lutp[(((c << 8) + b) << 8) + a];
+      int a = clampSrc<src_pixel_t, src_bits>(srcp[0][x]),
+          b = clampSrc<src_pixel_t, src_bits>(srcp[1][x]),
+          c = clampSrc<src_pixel_t, src_bits>(srcp[2][x]);
+      dstp[x] = lutp[(((c << src_bits) + b) << src_bits) + a];
     }
     srcp[0] += src_pitch[0];
     srcp[1] += src_pitch[1];
@@ -333,17 +381,16 @@ static void write_3plane_to_1plane
   
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
-void write_3plane_to_3plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst) const {
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
+void write_3plane_to_3plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame& dst, int y_begin, int y_end) const {
   
   int src_pitch[3];
   const src_pixel_t* srcp[3];
   
   for (int i = 0; i < 3; ++i) {
-    int sc = std::min(i, num_src_clips - 1),
-        sp = std::min(num_src_clips == 1 ? i : 0, num_src_planes - 1);
-    src_pitch[i] = src[sc]->GetPitch(src_planes[sc][sp]) >> src_pitch_bitshift;
-    srcp[i] = (const src_pixel_t*)src[sc]->GetReadPtr(src_planes[sc][sp]);
+    int sc = src_clip_map[0][i], sp = src_plane_map[0][i];
+    src_pitch[i] = src[sc]->GetPitch(sp) >> src_pitch_bitshift;
+    srcp[i] = (const src_pixel_t*)src[sc]->GetReadPtr(sp) + y_begin * src_pitch[i];
   }
   
   const dst_pixel_t* lutp[3];
@@ -353,20 +400,21 @@ void write_3plane_to_3plane_wrapper (std::vector<PVideoFrame>& src, PVideoFrame&
   for (int p = 0; p < num_dst_planes; ++p) {
     lutp[p] = (const dst_pixel_t*) lut->GetReadPtr(dst_planes[p]);
     dst_pitch[p] = dst->GetPitch(dst_planes[p]) >> dst_pitch_bitshift;
-    dstp[p] = (dst_pixel_t*) dst->GetWritePtr(dst_planes[p]);
+    dstp[p] = (dst_pixel_t*) dst->GetWritePtr(dst_planes[p]) + y_begin * dst_pitch[p];
   }
   
-  write_3plane_to_3plane <src_pixel_t, dst_pixel_t>
-  (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[0], dst_height[0]);
+  write_3plane_to_3plane <src_pixel_t, dst_pixel_t, src_bits>
+  (src_pitch, srcp, dst_pitch, lutp, dstp, dst_width[0], y_end - y_begin, y_begin);
   
 }
 
-template <typename src_pixel_t, typename dst_pixel_t>
+template <typename src_pixel_t, typename dst_pixel_t, int src_bits>
 static void write_3plane_to_3plane
 (int src_pitch[3], const src_pixel_t* srcp[3],
   int dst_pitch[3], const dst_pixel_t* lutp[3], dst_pixel_t* dstp[3],
-  int width, int height) {
+  int width, int height, int y_begin) {
   
+  bool check_runs = y_begin % RUN_RETRY_ROWS == 0;
   for (int y = 0; y < height; ++y) {
 #ifdef __INTEL_COMPILER
     #pragma ivdep
@@ -380,12 +428,37 @@ static void write_3plane_to_3plane
     __assume_aligned(dstp[1], 64);
     __assume_aligned(dstp[2], 64);
 #endif
-    for (int x = 0; x < width; ++x) {
-      int a = srcp[0][x], b = srcp[1][x], c = srcp[2][x];
-      int abc = (((c << 8) + b) << 8) + a;
-      dstp[0][x] = lutp[0][abc];
-      dstp[1][x] = lutp[1][abc];
-      dstp[2][x] = lutp[2][abc];
+    if (check_runs) {
+      int prev_abc = -1, hits = 0;
+      dst_pixel_t d0 = 0, d1 = 0, d2 = 0;
+      for (int x = 0; x < width; ++x) {
+        int a = clampSrc<src_pixel_t, src_bits>(srcp[0][x]),
+            b = clampSrc<src_pixel_t, src_bits>(srcp[1][x]),
+            c = clampSrc<src_pixel_t, src_bits>(srcp[2][x]);
+        int abc = (((c << src_bits) + b) << src_bits) + a;
+        if (abc != prev_abc) {
+          prev_abc = abc;
+          d0 = lutp[0][abc];
+          d1 = lutp[1][abc];
+          d2 = lutp[2][abc];
+        } else
+          ++hits;
+        dstp[0][x] = d0;
+        dstp[1][x] = d1;
+        dstp[2][x] = d2;
+      }
+      check_runs = hits >= width / RUN_MIN_HIT_DIVISOR;
+    } else {
+      for (int x = 0; x < width; ++x) {
+        int a = clampSrc<src_pixel_t, src_bits>(srcp[0][x]),
+            b = clampSrc<src_pixel_t, src_bits>(srcp[1][x]),
+            c = clampSrc<src_pixel_t, src_bits>(srcp[2][x]);
+        int abc = (((c << src_bits) + b) << src_bits) + a;
+        dstp[0][x] = lutp[0][abc];
+        dstp[1][x] = lutp[1][abc];
+        dstp[2][x] = lutp[2][abc];
+      }
+      check_runs = (y_begin + y + 1) % RUN_RETRY_ROWS == 0;
     }
     srcp[0] += src_pitch[0];
     srcp[1] += src_pitch[1];